@@ -0,0 +1,76 @@
+#ifndef BOARD_SNAPSHOT_H
+#define BOARD_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "shared_board.h"
+
+// Scoreboard file written by EXPORT_SNAPSHOT: a BoardSnapshotHeader, then
+// teamCount BoardRow records in ranking order at rowsOffset, then a table
+// of teamCount zero-padded names indexed by team id at namesOffset. All
+// fields are little-endian and every section is 8-byte aligned, so a
+// reader maps the file and uses BoardSnapshotView to index it in place.
+
+const char kBoardSnapshotMagic[8] = {'I', 'C', 'P', 'C', 'S', 'N', 'A', 'P'};
+const uint32_t kBoardSnapshotVersion = 1;
+
+struct BoardSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t rowSize;  // sizeof(BoardRow)
+    uint32_t nameSize;  // kBoardNameSize
+    uint32_t teamCount;
+    uint32_t problemCount;
+    uint32_t boardVersion;  // flush number of the board
+    uint64_t rowsOffset;
+    uint64_t namesOffset;
+};
+
+static_assert(sizeof(BoardSnapshotHeader) == 48, "unexpected header layout");
+
+class BoardSnapshotView {
+public:
+    BoardSnapshotView() : base(nullptr), head(nullptr) {}
+
+    // Checks the layout of a mapped snapshot of `size` bytes; the view is
+    // usable only if this returns true.
+    bool open(const void* data, size_t size) {
+        base = static_cast<const char*>(data);
+        head = nullptr;
+        if (size < sizeof(BoardSnapshotHeader)) {
+            return false;
+        }
+        const BoardSnapshotHeader* h =
+            reinterpret_cast<const BoardSnapshotHeader*>(base);
+        if (std::memcmp(h->magic, kBoardSnapshotMagic, 8) != 0 ||
+            h->version != kBoardSnapshotVersion ||
+            h->rowSize != sizeof(BoardRow) ||
+            h->nameSize != kBoardNameSize ||
+            h->rowsOffset + uint64_t(h->teamCount) * h->rowSize > size ||
+            h->namesOffset + uint64_t(h->teamCount) * h->nameSize > size) {
+            return false;
+        }
+        head = h;
+        return true;
+    }
+
+    const BoardSnapshotHeader& header() const { return *head; }
+
+    // Row of the team ranked `index + 1`.
+    const BoardRow& row(uint32_t index) const {
+        return reinterpret_cast<const BoardRow*>(base + head->rowsOffset)
+            [index];
+    }
+
+    const char* name(uint32_t team) const {
+        return base + head->namesOffset + size_t(team) * kBoardNameSize;
+    }
+
+private:
+    const char* base;
+    const BoardSnapshotHeader* head;
+};
+
+#endif
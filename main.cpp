@@ -5,168 +5,1441 @@
 #include <map>
 #include <algorithm>
 #include <sstream>
+#include <utility>
+#include <queue>
+#include <set>
+#include <fstream>
+#include <cassert>
+#include <thread>
+#include <system_error>
+#include <cstring>
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "board_snapshot.h"
+#include "scroll_frames.h"
+#include "shared_board.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define ICPC_X86_SIMD 1
+#endif
 
 using namespace std;
 
-struct Submission {
-    string problem;
-    string status;
-    int time;
+const int kMaxProblems = 26;
+// Slots of a team's sorted solve-time list: kMaxProblems rounded up to
+// whole SIMD vectors. Times reach 10^5, so lanes stay 32 bits wide.
+const int kTimeSlots = 32;
+static_assert(kBoardProblems == kMaxProblems, "board rows hold every problem");
+
+// Expands f(0), f(1), ..., f(N - 1) at compile time so per-problem loops
+// have a fixed trip count and no bounds checks.
+template <int N>
+struct Unroll {
+    template <typename F>
+    static void run(F& f) {
+        Unroll<N - 1>::run(f);
+        f(N - 1);
+    }
+};
+
+template <>
+struct Unroll<0> {
+    template <typename F>
+    static void run(F&) {}
 };
 
-struct ProblemStatus {
-    bool solved;
-    int solveTime;
-    int wrongAttempts;
-    vector<Submission> frozenSubs;
-    bool wasSolvedBeforeFreeze;
+// Runs body(begin, end) over slices of [0, count) on all hardware threads.
+// Small ranges stay on the calling thread, where spawning would cost more
+// than the work.
+template <typename Body>
+void parallelFor(int count, const Body& body) {
+    const int kMinSlice = 256;
+    int workers = min<int>(max(1u, thread::hardware_concurrency()),
+                           count / kMinSlice);
+    if (workers <= 1) {
+        body(0, count);
+        return;
+    }
+    vector<thread> threads;
+    int slice = (count + workers - 1) / workers;
+    int begin = slice;
+    try {
+        for (; begin < count; begin += slice) {
+            threads.emplace_back(body, begin, min(count, begin + slice));
+        }
+    } catch (const system_error&) {
+        // Out of threads: the slices not handed off run here instead.
+        for (; begin < count; begin += slice) {
+            body(begin, min(count, begin + slice));
+        }
+    }
+    body(0, slice);
+    for (thread& t : threads) {
+        t.join();
+    }
+}
+
+const int kMedalCount = 3;
+const char* const kMedalNames[kMedalCount] = {"GOLD", "SILVER", "BRONZE"};
 
-    ProblemStatus() : solved(false), solveTime(0), wrongAttempts(0),
-                      wasSolvedBeforeFreeze(false) {}
+const int kStatusCount = 4;
+const int kAccepted = 0;
+const char* const kStatusNames[kStatusCount] = {
+    "Accepted", "Wrong_Answer", "Runtime_Error", "Time_Limit_Exceed"};
+
+int parseStatus(const string& status) {
+    for (int i = 0; i < kStatusCount; i++) {
+        if (status == kStatusNames[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// A compiled WHERE clause of a submission query: the accepted problems and
+// statuses as bit masks.
+struct SubmissionFilter {
+    unsigned problems;
+    unsigned statuses;
 };
 
+const unsigned kAllProblems = (1u << kMaxProblems) - 1;
+const unsigned kAllStatuses = (1u << kStatusCount) - 1;
+
+// Compiles "ALL" or a '|'-separated list of values, e.g. "A|C|F" or
+// "Wrong_Answer|Runtime_Error".
+SubmissionFilter compileFilter(const string& problem, const string& status) {
+    SubmissionFilter filter = {0, 0};
+    if (problem == "ALL") {
+        filter.problems = kAllProblems;
+    } else {
+        for (size_t i = 0; i < problem.size(); i += 2) {
+            filter.problems |= 1u << (problem[i] - 'A');
+        }
+    }
+    if (status == "ALL") {
+        filter.statuses = kAllStatuses;
+    } else {
+        istringstream values(status);
+        string value;
+        while (getline(values, value, '|')) {
+            filter.statuses |= 1u << parseStatus(value);
+        }
+    }
+    return filter;
+}
+
+// Besides its own fields, each logged submission links to the previous
+// one by the same team with the same problem, status, or both, so every
+// filter of QUERY_SUBMISSION walks only matching entries.
+struct Submission {
+    int team;
+    int problem;
+    int status;
+    int time;
+    int prevByTeam;  // log indices, -1 at the start of a chain
+    int prevByProblem;
+    int prevByStatus;
+    int prevByProblemStatus;
+};
+
+// Inserts a time into a descending, zero-padded solve-time list.
+inline void insertSolveTime(int* times, int time) {
+    int pos = 0;
+    while (times[pos] >= time) {
+        pos++;
+    }
+    move_backward(times + pos, times + kMaxProblems - 1, times + kMaxProblems);
+    times[pos] = time;
+}
+
 struct Team {
     string name;
-    unordered_map<string, ProblemStatus> problems;
-    vector<Submission> submissions;
+    int sortedSolveTimes[kTimeSlots];  // descending, zero-padded
+    vector<Submission> frozenSubs[kMaxProblems];
+    vector<int> submissions;  // indices into the submission log
+    int lastByProblem[kMaxProblems];
+    int lastByStatus[kStatusCount];
+    int lastByProblemStatus[kMaxProblems][kStatusCount];
+
+    Team(string n = "") : name(n) {
+        fill(sortedSolveTimes, sortedSolveTimes + kTimeSlots, 0);
+        fill(lastByProblem, lastByProblem + kMaxProblems, -1);
+        fill(lastByStatus, lastByStatus + kStatusCount, -1);
+        fill(&lastByProblemStatus[0][0],
+             &lastByProblemStatus[0][0] + kMaxProblems * kStatusCount, -1);
+    }
 
-    Team(string n = "") : name(n) {}
+    void addSolveTime(int time) {
+        insertSolveTime(sortedSolveTimes, time);
+    }
 };
 
+// Lexicographic comparison of two sorted solve-time lists that both hold
+// `count` entries: negative when a ranks higher, zero when equal.
+inline int compareSolveTimes(const int* a, const int* b, int count) {
+#if defined(__AVX2__)
+    for (int i = 0; i < count; i += 8) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        int eq = _mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(va, vb)));
+        if (eq != 0xFF) {
+            int lane = i + __builtin_ctz(~eq);
+            return lane >= count ? 0 : (a[lane] < b[lane] ? -1 : 1);
+        }
+    }
+#elif defined(ICPC_X86_SIMD)
+    for (int i = 0; i < count; i += 4) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        int eq = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, vb)));
+        if (eq != 0xF) {
+            int lane = i + __builtin_ctz(~eq);
+            return lane >= count ? 0 : (a[lane] < b[lane] ? -1 : 1);
+        }
+    }
+#else
+    for (int i = 0; i < count; i++) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+#endif
+    return 0;
+}
+
+// Visible problem cells in structure-of-arrays layout: one row of `stride`
+// teams per problem, padded with empty cells up to a whole SIMD block.
+struct CellTable {
+    static const int kBlock = 8;
+
+    int stride;
+    vector<int> solveTimes;  // 0 while the problem is unsolved
+    vector<int> wrongCounts;
+
+    CellTable() : stride(0) {}
+
+    void reset(int problems, int teamCount) {
+        stride = (teamCount + kBlock - 1) / kBlock * kBlock;
+        solveTimes.assign(problems * stride, 0);
+        wrongCounts.assign(problems * stride, 0);
+    }
+
+    int& solveTime(int p, int team) { return solveTimes[p * stride + team]; }
+    int solveTime(int p, int team) const {
+        return solveTimes[p * stride + team];
+    }
+    int& wrongAttempts(int p, int team) {
+        return wrongCounts[p * stride + team];
+    }
+    int wrongAttempts(int p, int team) const {
+        return wrongCounts[p * stride + team];
+    }
+};
+
+// Per-problem figures for commentary. Accepted teams and the first solver
+// only cover solves visible on the board, so frozen results join them when
+// they are scrolled.
+struct ProblemStats {
+    int attempts;
+    int accepted;
+    int firstSolver;  // team id, -1 until somebody solves it
+    int firstSolveTime;
+
+    ProblemStats() : attempts(0), accepted(0), firstSolver(-1),
+                     firstSolveTime(0) {}
+};
+
+// Buffers output and hands it to the stream in large blocks, for boards
+// too big to format through operator<< one field at a time.
+class BlockWriter {
+public:
+    explicit BlockWriter(ostream& out) : out(out), used(0) {}
+    ~BlockWriter() { flush(); }
+
+    void append(const char* text, size_t length) {
+        if (used + length > sizeof(buffer)) {
+            flush();
+            if (length > sizeof(buffer)) {
+                out.write(text, length);
+                return;
+            }
+        }
+        memcpy(buffer + used, text, length);
+        used += length;
+    }
+
+    void append(const string& text) { append(text.data(), text.size()); }
+
+    void append(char c) { append(&c, 1); }
+
+    void appendInt(int value) {
+        char digits[12];
+        char* end = digits + sizeof(digits);
+        char* begin = end;
+        unsigned magnitude = value < 0 ? 0u - value : value;
+        do {
+            *--begin = '0' + magnitude % 10;
+            magnitude /= 10;
+        } while (magnitude > 0);
+        if (value < 0) {
+            *--begin = '-';
+        }
+        append(begin, end - begin);
+    }
+
+    void flush() {
+        out.write(buffer, used);
+        used = 0;
+    }
+
+private:
+    ostream& out;
+    char buffer[1 << 16];
+    size_t used;
+};
+
+// Everything a team's position depends on except its name.
+struct RankKey {
+    int solved;
+    int penalty;
+    int times[kTimeSlots];
+};
+
+// Scoring rules are a compile-time policy of the engine, so every rule set
+// gets its own instantiation of the ranking code rather than runtime
+// branches in the comparator.
+template <int PenaltyPerWrong, bool CompareSolveTimes>
+struct ScoringRules {
+    static constexpr int kPenaltyPerWrong = PenaltyPerWrong;
+    static constexpr bool kCompareSolveTimes = CompareSolveTimes;
+
+    static int penalty(int solveTime, int wrongAttempts) {
+        return solveTime + kPenaltyPerWrong * wrongAttempts;
+    }
+
+    // Negative when a ranks above b; zero when only names can order them.
+    static int compare(const RankKey& a, const RankKey& b) {
+        if (a.solved != b.solved) return a.solved > b.solved ? -1 : 1;
+        if (a.penalty != b.penalty) return a.penalty < b.penalty ? -1 : 1;
+        if (kCompareSolveTimes) {
+            return compareSolveTimes(a.times, b.times, a.solved);
+        }
+        return 0;
+    }
+};
+
+typedef ScoringRules<20, true> IcpcRules;
+
+// Solved count and penalty of teams [begin, end) straight from the cell
+// columns; begin and end are multiples of CellTable::kBlock.
+typedef void (*AggregateFn)(const CellTable&, int, int, int*, int*);
+
+template <int M, typename Rules>
+void aggregateScalar(const CellTable& cells, int begin, int end,
+                     int* solved, int* penalty) {
+    for (int team = begin; team < end; team++) {
+        int s = 0, pen = 0;
+        for (int p = 0; p < M; p++) {
+            int t = cells.solveTime(p, team);
+            if (t > 0) {
+                s++;
+                pen += Rules::penalty(t, cells.wrongAttempts(p, team));
+            }
+        }
+        solved[team] = s;
+        penalty[team] = pen;
+    }
+}
+
+#ifdef ICPC_X86_SIMD
+// SSE2 has no 32-bit low multiply, so combine the even and odd lanes of
+// two 32x32->64 multiplies.
+static inline __m128i mulLo32(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+template <int M, typename Rules>
+void aggregateSse2(const CellTable& cells, int begin, int end,
+                   int* solved, int* penalty) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i k = _mm_set1_epi32(Rules::kPenaltyPerWrong);
+    for (int base = begin; base < end; base += 4) {
+        __m128i s = zero, pen = zero;
+        auto column = [&](int p) {
+            const int offset = p * cells.stride + base;
+            __m128i t = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(&cells.solveTimes[offset]));
+            __m128i w = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(&cells.wrongCounts[offset]));
+            __m128i mask = _mm_cmpgt_epi32(t, zero);
+            s = _mm_sub_epi32(s, mask);
+            pen = _mm_add_epi32(
+                pen, _mm_and_si128(mask, _mm_add_epi32(t, mulLo32(w, k))));
+        };
+        Unroll<M>::run(column);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(solved + base), s);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(penalty + base), pen);
+    }
+}
+
+// Lambdas do not inherit the target attribute, so this one keeps a plain
+// fixed-count loop instead of Unroll.
+template <int M, typename Rules>
+__attribute__((target("avx2")))
+void aggregateAvx2(const CellTable& cells, int begin, int end,
+                   int* solved, int* penalty) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i k = _mm256_set1_epi32(Rules::kPenaltyPerWrong);
+    for (int base = begin; base < end; base += 8) {
+        __m256i s = zero, pen = zero;
+        for (int p = 0; p < M; p++) {
+            const int offset = p * cells.stride + base;
+            __m256i t = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(&cells.solveTimes[offset]));
+            __m256i w = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(&cells.wrongCounts[offset]));
+            __m256i mask = _mm256_cmpgt_epi32(t, zero);
+            s = _mm256_sub_epi32(s, mask);
+            pen = _mm256_add_epi32(
+                pen, _mm256_and_si256(
+                         mask, _mm256_add_epi32(t, _mm256_mullo_epi32(w, k))));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(solved + base), s);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(penalty + base), pen);
+    }
+}
+#endif
+
+template <int M, typename Rules>
+AggregateFn selectAggregate() {
+#ifdef ICPC_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return &aggregateAvx2<M, Rules>;
+    }
+    return &aggregateSse2<M, Rules>;
+#else
+    return &aggregateScalar<M, Rules>;
+#endif
+}
+
+template <typename Rules>
 class ICPCSystem {
 private:
-    unordered_map<string, Team> teams;
-    vector<string> teamNames;
+    // A frozen cell as it will look once scrolled.
+    struct FrozenCell {
+        int problem;
+        int wrongAttempts;
+        int solveTime;  // 0 if no frozen submission was accepted
+    };
+
+    // Orders team ids by their entries in a key vector, then by name.
+    struct KeyOrder {
+        const vector<RankKey>* keys;
+        const vector<Team>* teams;
+
+        bool operator()(int a, int b) const {
+            int cmp = Rules::compare((*keys)[a], (*keys)[b]);
+            if (cmp != 0) return cmp < 0;
+            return (*teams)[a].name < (*teams)[b].name;
+        }
+    };
+
+    // Team ids in ranking order, with ranks available in O(log N).
+    typedef __gnu_pbds::tree<int, __gnu_pbds::null_type, KeyOrder,
+                             __gnu_pbds::rb_tree_tag,
+                             __gnu_pbds::tree_order_statistics_node_update>
+        RankTree;
+
+    typedef void (*PrintRowFn)(const CellTable&, const Team&, int, int,
+                               const RankKey&);
+
+    // Hot per-team loops, instantiated for every problem count and picked
+    // once at START.
+    struct ProblemKernels {
+        AggregateFn aggregate;
+        PrintRowFn printRow;
+        PrintRowFn printRevealedRow;
+        void (*collectFrozenCells)(const CellTable&, const Team&, int,
+                                   vector<FrozenCell>&);
+    };
+
+    vector<Team> teams;
+    unordered_map<string, int> teamIndex;
+    CellTable cells;
     bool started;
     bool frozen;
     int durationTime;
     int problemCount;
-    vector<string> problemList;
-    vector<pair<string, int>> lastRanking;
-
-    struct TeamRankInfo {
-        string name;
+    const ProblemKernels* kernels;
+    vector<pair<int, int>> lastRanking;
+    vector<RankKey> lastRankingKeys;  // parallel to lastRanking
+
+    // Cells as of the latest FLUSH or SCROLL, for the exports that pair
+    // them with lastRanking. Only teams whose cells changed since are
+    // copied over at the next one.
+    CellTable flushedCells;
+    vector<int> flushedFrozenCounts;  // laid out like flushedCells
+    vector<int> unflushedCellTeams;
+    vector<char> cellsUnflushed;
+    ProblemStats problemStats[kMaxProblems];
+
+    // Every submission in input order, which is also time order, plus
+    // per-problem posting lists; per-team lists live in Team.
+    vector<Submission> submissionLog;
+    vector<int> problemSubmissions[kMaxProblems];
+
+    // Flushed rankings over time. Version 0 is the board at START; every
+    // FLUSH and every finished SCROLL adds one. Only solves are stored,
+    // each tagged with the first version that shows it, so a team's key at
+    // any version is a prefix of its list.
+    struct SolveRecord {
+        int version;
+        int time;
+        int penalty;  // running total including this solve
+    };
+    vector<vector<SolveRecord>> solveHistory;
+    int rankingVersions;
+
+    // Each version's board as a persistent treap of team states, a state
+    // being a team with only its first `solved` solves. A solve moves one
+    // state, copying just the nodes made before the version being built,
+    // so versions share the rest and a past rank is one descent.
+    struct HistoryNode {
+        int left, right;  // 0 is the empty tree
+        int size;
+        int team;
         int solved;
-        int penalty;
-        vector<int> times;
     };
-
-    TeamRankInfo getTeamRankInfo(const string& teamName) {
-        TeamRankInfo info;
-        info.name = teamName;
-        info.solved = 0;
-        info.penalty = 0;
-
-        const Team& t = teams[teamName];
-        for (const auto& prob : problemList) {
-            auto it = t.problems.find(prob);
-            if (it != t.problems.end()) {
-                const ProblemStatus& ps = it->second;
-                if (ps.solved && ps.wasSolvedBeforeFreeze) {
-                    info.solved++;
-                    int penalty = ps.solveTime + 20 * ps.wrongAttempts;
-                    info.penalty += penalty;
-                    info.times.push_back(ps.solveTime);
+    vector<HistoryNode> historyNodes;
+    vector<int> versionRoots;
+    int historyRoot;  // the version being built
+    int historyOwned;  // first node made by the version being built
+
+    // The flushed ranking split by solved count: each bucket holds team ids
+    // in ranking order under flushedKeys. A solve moves a team between two
+    // buckets and leaves the rest of the board alone.
+    vector<int> rankBuckets[kMaxProblems + 1];
+    vector<RankKey> flushedKeys;  // by team id
+
+    // Teams with solves not yet flushed.
+    vector<int> changedTeams;
+    vector<char> changed;
+
+    // Teams flushed but not yet moved through the buckets. FLUSH only
+    // hands changed teams over to this list; the moves, with each key taken
+    // at the latest version, wait until something looks at the ranking
+    // (see observeRanking).
+    vector<int> pendingTeams;
+    vector<char> pending;
+
+    int medalCounts[kMedalCount];  // set by SET_MEDALS
+
+    // What the last printed board showed: each team's rank, and which rows
+    // have had a cell change since. SET_BOARD_OUTPUT DELTA prints only the
+    // rows these say differ.
+    bool deltaOutput;
+    vector<int> shownRanks;
+    vector<int> dirtyRows;
+    vector<char> rowDirty;
+
+    // The standings as they would be without the freeze: cells, keys and
+    // order updated on every submission, frozen or not.
+    CellTable trueCells;
+    vector<RankKey> trueKeys;
+    RankTree trueOrder;
+
+    // Armed by EXPORT_SCROLL; the next scroll or preview writes its frames
+    // here and closes it.
+    ofstream scrollExport;
+
+    // Per-team row openings for EXPORT_BOARD, built on first use.
+    vector<string> jsonRowFragments;
+    vector<string> csvRowFragments;
+
+    // Mapped by PUBLISH_BOARD; every FLUSH and SCROLL rewrites it.
+    SharedBoardHeader* sharedBoard;
+    size_t sharedBoardBytes;
+
+    // Sites merged by QUERY_MERGED_BOARD: this engine's flushed board as
+    // site 0, then every board attached by ADD_SITE. Each keeps its rows
+    // in its own ranking order. The merged standings are kept between
+    // queries, and a site is re-read and merged back in only after it has
+    // published again.
+    struct Site {
+        string name;
+        const SharedBoardHeader* shared;  // null for this engine
+        size_t bytes;
+        uint32_t sequence;  // publish (or flush) last read
+        vector<char> nameTable;  // copied names of a remote site
+        vector<const char*> teamNames;
+        vector<RankKey> keys;
+    };
+    vector<Site> sites;
+    vector<pair<int, int>> mergedBoard;  // (site, index in its run)
+
+    // Heads of the chains whose union is exactly team t's submissions that
+    // pass the filter, plus the link each chain follows. Each side set to
+    // ALL lets the chains ignore that field; otherwise there is one chain
+    // per listed value, or per listed (problem, status) pair.
+    static void filterChains(const Team& t, const SubmissionFilter& filter,
+                             vector<int>& heads, int Submission::*& link) {
+        heads.clear();
+        bool allProblems = filter.problems == kAllProblems;
+        bool allStatuses = filter.statuses == kAllStatuses;
+        if (allProblems && allStatuses) {
+            link = &Submission::prevByTeam;
+            if (!t.submissions.empty()) {
+                heads.push_back(t.submissions.back());
+            }
+        } else if (allProblems) {
+            link = &Submission::prevByStatus;
+            for (unsigned s = filter.statuses; s; s &= s - 1) {
+                heads.push_back(t.lastByStatus[__builtin_ctz(s)]);
+            }
+        } else if (allStatuses) {
+            link = &Submission::prevByProblem;
+            for (unsigned p = filter.problems; p; p &= p - 1) {
+                heads.push_back(t.lastByProblem[__builtin_ctz(p)]);
+            }
+        } else {
+            link = &Submission::prevByProblemStatus;
+            for (unsigned p = filter.problems; p; p &= p - 1) {
+                for (unsigned s = filter.statuses; s; s &= s - 1) {
+                    heads.push_back(t.lastByProblemStatus[__builtin_ctz(p)]
+                                                         [__builtin_ctz(s)]);
                 }
             }
         }
-        sort(info.times.rbegin(), info.times.rend());
-        return info;
+        heads.erase(remove(heads.begin(), heads.end(), -1), heads.end());
+    }
+
+    void printSubmission(const Submission& sub) {
+        cout << teams[sub.team].name << " " << char('A' + sub.problem) << " "
+             << kStatusNames[sub.status] << " " << sub.time << "\n";
+    }
+
+    // Prints the entries of a posting list with time in [from, to]; the
+    // log is time-ordered, so they form one contiguous run.
+    void printSubmissionsBetween(const vector<int>& postings, int from,
+                                 int to) {
+        auto it = lower_bound(
+            postings.begin(), postings.end(), from,
+            [&](int index, int t) { return submissionLog[index].time < t; });
+        if (it == postings.end() || submissionLog[*it].time > to) {
+            cout << "Cannot find any submission.\n";
+            return;
+        }
+        for (; it != postings.end() && submissionLog[*it].time <= to; ++it) {
+            printSubmission(submissionLog[*it]);
+        }
+    }
+
+    int solvedAt(int id, int version) const {
+        const vector<SolveRecord>& history = solveHistory[id];
+        return upper_bound(history.begin(), history.end(), version,
+                           [](int v, const SolveRecord& r) {
+                               return v < r.version;
+                           }) -
+               history.begin();
+    }
+
+    // Key of a team counting only its first `solved` solves. Solve times
+    // only break ties, so callers may leave them out.
+    RankKey stateKey(int id, int solved, bool withTimes = true) const {
+        const vector<SolveRecord>& history = solveHistory[id];
+        RankKey key = RankKey();
+        key.solved = solved;
+        if (solved > 0) {
+            key.penalty = history[solved - 1].penalty;
+        }
+        if (Rules::kCompareSolveTimes && withTimes) {
+            for (int i = 0; i < solved; i++) {
+                insertSolveTime(key.times, history[i].time);
+            }
+        }
+        return key;
+    }
+
+    RankKey keyAt(int id, int version) const {
+        return stateKey(id, solvedAt(id, version));
+    }
+
+    // Board order of two team states: key, then name.
+    int compareStates(int a, int solvedA, int b, int solvedB) const {
+        int cmp = Rules::compare(stateKey(a, solvedA, false),
+                                 stateKey(b, solvedB, false));
+        if (cmp == 0 && Rules::kCompareSolveTimes) {
+            cmp = Rules::compare(stateKey(a, solvedA), stateKey(b, solvedB));
+        }
+        if (cmp != 0) {
+            return cmp;
+        }
+        return teams[a].name.compare(teams[b].name);
+    }
+
+    bool historyBefore(int a, int b) const {
+        return compareStates(historyNodes[a].team, historyNodes[a].solved,
+                             historyNodes[b].team, historyNodes[b].solved) < 0;
+    }
+
+    static uint32_t historyPriority(const HistoryNode& node) {
+        uint32_t h = node.team * 0x9E3779B1u + node.solved * 0x85EBCA77u;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        h *= 0x297A2D39u;
+        return h ^ (h >> 15);
+    }
+
+    int newHistoryNode(int id, int solved) {
+        historyNodes.push_back({0, 0, 1, id, solved});
+        return historyNodes.size() - 1;
+    }
+
+    // Node t as the version being built may change it: a copy unless that
+    // version made it.
+    int ownHistoryNode(int t) {
+        if (t < historyOwned) {
+            historyNodes.push_back(historyNodes[t]);
+            t = historyNodes.size() - 1;
+        }
+        return t;
+    }
+
+    void updateHistorySize(int t) {
+        HistoryNode& node = historyNodes[t];
+        node.size = 1 + historyNodes[node.left].size +
+                    historyNodes[node.right].size;
+    }
+
+    // Splits tree t into the states ranked ahead of node n and the rest.
+    void splitHistory(int t, int n, int& ahead, int& behind) {
+        if (t == 0) {
+            ahead = behind = 0;
+            return;
+        }
+        t = ownHistoryNode(t);
+        int first, second;
+        if (historyBefore(t, n)) {
+            splitHistory(historyNodes[t].right, n, first, second);
+            historyNodes[t].right = first;
+            ahead = t;
+            behind = second;
+        } else {
+            splitHistory(historyNodes[t].left, n, first, second);
+            historyNodes[t].left = second;
+            ahead = first;
+            behind = t;
+        }
+        updateHistorySize(t);
+    }
+
+    // Joins two trees whose states all rank `ahead` before `behind`.
+    int mergeHistory(int ahead, int behind) {
+        if (ahead == 0 || behind == 0) {
+            return ahead + behind;
+        }
+        if (historyPriority(historyNodes[ahead]) >
+            historyPriority(historyNodes[behind])) {
+            ahead = ownHistoryNode(ahead);
+            int child = mergeHistory(historyNodes[ahead].right, behind);
+            historyNodes[ahead].right = child;
+            updateHistorySize(ahead);
+            return ahead;
+        }
+        behind = ownHistoryNode(behind);
+        int child = mergeHistory(ahead, historyNodes[behind].left);
+        historyNodes[behind].left = child;
+        updateHistorySize(behind);
+        return behind;
+    }
+
+    int insertHistory(int t, int n) {
+        if (t == 0) {
+            return n;
+        }
+        if (historyPriority(historyNodes[n]) >
+            historyPriority(historyNodes[t])) {
+            int ahead, behind;
+            splitHistory(t, n, ahead, behind);
+            historyNodes[n].left = ahead;
+            historyNodes[n].right = behind;
+            updateHistorySize(n);
+            return n;
+        }
+        t = ownHistoryNode(t);
+        if (historyBefore(n, t)) {
+            int child = insertHistory(historyNodes[t].left, n);
+            historyNodes[t].left = child;
+        } else {
+            int child = insertHistory(historyNodes[t].right, n);
+            historyNodes[t].right = child;
+        }
+        updateHistorySize(t);
+        return t;
+    }
+
+    int eraseHistory(int t, int id, int solved) {
+        int cmp = compareStates(id, solved, historyNodes[t].team,
+                                historyNodes[t].solved);
+        if (cmp == 0) {
+            return mergeHistory(historyNodes[t].left, historyNodes[t].right);
+        }
+        t = ownHistoryNode(t);
+        if (cmp < 0) {
+            int child = eraseHistory(historyNodes[t].left, id, solved);
+            historyNodes[t].left = child;
+        } else {
+            int child = eraseHistory(historyNodes[t].right, id, solved);
+            historyNodes[t].right = child;
+        }
+        updateHistorySize(t);
+        return t;
+    }
+
+    // The board being built is final from here on.
+    void closeRankingVersion() {
+        versionRoots.push_back(historyRoot);
+        historyOwned = historyNodes.size();
+        rankingVersions++;
     }
 
-    void calculateRanking(vector<pair<string, int>>& ranking) {
+    void updateTrueRanking(const Submission& sub) {
+        int& solveTime = trueCells.solveTime(sub.problem, sub.team);
+        if (solveTime > 0) {
+            return;
+        }
+        if (sub.status != kAccepted) {
+            trueCells.wrongAttempts(sub.problem, sub.team)++;
+            return;
+        }
+
+        trueOrder.erase(sub.team);
+        solveTime = sub.time;
+        RankKey& key = trueKeys[sub.team];
+        key.solved++;
+        key.penalty += Rules::penalty(
+            sub.time, trueCells.wrongAttempts(sub.problem, sub.team));
+        if (Rules::kCompareSolveTimes) {
+            insertSolveTime(key.times, sub.time);
+        }
+        trueOrder.insert(sub.team);
+    }
+
+    void markSolved(int p, int id, int time) {
+        if (!changed[id]) {
+            changed[id] = true;
+            changedTeams.push_back(id);
+        }
+        // The next FLUSH or SCROLL is the first version to show it.
+        vector<SolveRecord>& history = solveHistory[id];
+        history.push_back(
+            {rankingVersions, time,
+             (history.empty() ? 0 : history.back().penalty) +
+                 Rules::penalty(time, cells.wrongAttempts(p, id))});
+        int solved = history.size();
+        historyRoot = eraseHistory(historyRoot, id, solved - 1);
+        historyRoot = insertHistory(historyRoot, newHistoryNode(id, solved));
+        cells.solveTime(p, id) = time;
+        if (Rules::kCompareSolveTimes) {
+            teams[id].addSolveTime(time);
+        }
+
+        // Ties on time go to whoever was shown solved first.
+        ProblemStats& stats = problemStats[p];
+        stats.accepted++;
+        if (stats.firstSolver < 0 || time < stats.firstSolveTime) {
+            stats.firstSolver = id;
+            stats.firstSolveTime = time;
+        }
+    }
+
+    static void copySolveTimes(const Team& t, RankKey& key) {
+        if (Rules::kCompareSolveTimes) {
+            copy(t.sortedSolveTimes, t.sortedSolveTimes + kTimeSlots,
+                 key.times);
+        }
+    }
+
+    // Replays a frozen cell's submissions onto its visible state.
+    static void revealFrozen(const vector<Submission>& frozenSubs, int& wrong,
+                             int& solveTime) {
+        for (const auto& sub : frozenSubs) {
+            if (sub.status == kAccepted) {
+                solveTime = sub.time;
+                return;
+            }
+            wrong++;
+        }
+    }
+
+    // A cell in scoreboard notation: +, +x, -x, x/y or -x/y, or ".".
+    static void appendCell(BlockWriter& out, int wrong, int solveTime,
+                           int frozenCount) {
+        if (solveTime > 0) {
+            out.append('+');
+            if (wrong > 0) {
+                out.appendInt(wrong);
+            }
+        } else if (frozenCount > 0) {
+            if (wrong > 0) {
+                out.append('-');
+            }
+            out.appendInt(wrong);
+            out.append('/');
+            out.appendInt(frozenCount);
+        } else if (wrong > 0) {
+            out.append('-');
+            out.appendInt(wrong);
+        } else {
+            out.append('.');
+        }
+    }
+
+    // With Reveal, frozen cells are shown as they will be after scrolling.
+    template <int M, bool Reveal>
+    static void printRow(const CellTable& cells, const Team& t, int id,
+                         int rank, const RankKey& key) {
+        cout << t.name << " " << rank << " " << key.solved << " "
+             << key.penalty;
+
+        auto cell = [&](int p) {
+            int wrong = cells.wrongAttempts(p, id);
+            int solveTime = cells.solveTime(p, id);
+            const vector<Submission>& frozenSubs = t.frozenSubs[p];
+            if (Reveal) {
+                revealFrozen(frozenSubs, wrong, solveTime);
+            }
+            cout << " ";
+            if (solveTime > 0) {
+                cout << "+";
+                if (wrong > 0) {
+                    cout << wrong;
+                }
+            } else if (!Reveal && !frozenSubs.empty()) {
+                if (wrong > 0) {
+                    cout << "-";
+                }
+                cout << wrong << "/" << frozenSubs.size();
+            } else if (wrong > 0) {
+                cout << "-" << wrong;
+            } else {
+                cout << ".";
+            }
+        };
+        Unroll<M>::run(cell);
+        cout << "\n";
+    }
+
+    // Frozen cells of a team in descending problem order, so the next one
+    // to scroll sits at the back.
+    template <int M>
+    static void collectFrozenCells(const CellTable& cells, const Team& t,
+                                   int id, vector<FrozenCell>& frozenCells) {
+        frozenCells.clear();
+        auto probe = [&](int p) {
+            const int q = M - 1 - p;
+            if (!t.frozenSubs[q].empty()) {
+                FrozenCell cell = {q, cells.wrongAttempts(q, id), 0};
+                revealFrozen(t.frozenSubs[q], cell.wrongAttempts,
+                             cell.solveTime);
+                frozenCells.push_back(cell);
+            }
+        };
+        Unroll<M>::run(probe);
+    }
+
+    template <int M>
+    static ProblemKernels makeKernels() {
+        return {selectAggregate<M, Rules>(), &printRow<M, false>,
+                &printRow<M, true>, &collectFrozenCells<M>};
+    }
+
+    template <int... Ms>
+    static const ProblemKernels* selectKernels(int m,
+                                               integer_sequence<int, Ms...>) {
+        static const ProblemKernels table[] = {makeKernels<Ms>()...};
+        return &table[m];
+    }
+
+    static const ProblemKernels* selectKernels(int m) {
+        return selectKernels(m, make_integer_sequence<int, kMaxProblems + 1>());
+    }
+
+    // Sorts all teams into `ranking`; when `orderedKeys` is given it
+    // receives each ranked team's key in the same order.
+    void calculateRanking(vector<pair<int, int>>& ranking,
+                          vector<RankKey>* orderedKeys = nullptr) {
         ranking.clear();
-        ranking.reserve(teamNames.size());
+        ranking.reserve(teams.size());
 
-        vector<TeamRankInfo> infos;
-        infos.reserve(teamNames.size());
+        vector<int> solved(cells.stride), penalty(cells.stride);
+        kernels->aggregate(cells, 0, cells.stride, solved.data(),
+                           penalty.data());
 
-        for (const auto& name : teamNames) {
-            infos.push_back(getTeamRankInfo(name));
+        vector<RankKey> keys(teams.size());
+        for (int i = 0; i < teams.size(); i++) {
+            keys[i].solved = solved[i];
+            keys[i].penalty = penalty[i];
+            copySolveTimes(teams[i], keys[i]);
         }
 
-        vector<int> indices(teamNames.size());
-        for (int i = 0; i < teamNames.size(); i++) {
+        vector<int> indices(teams.size());
+        for (int i = 0; i < teams.size(); i++) {
             indices[i] = i;
         }
 
         sort(indices.begin(), indices.end(), [&](int a, int b) {
-            const TeamRankInfo& ta = infos[a];
-            const TeamRankInfo& tb = infos[b];
-
-            if (ta.solved != tb.solved) return ta.solved > tb.solved;
-            if (ta.penalty != tb.penalty) return ta.penalty < tb.penalty;
-            if (ta.times != tb.times) return ta.times < tb.times;
-            return ta.name < tb.name;
+            int cmp = Rules::compare(keys[a], keys[b]);
+            if (cmp != 0) return cmp < 0;
+            return teams[a].name < teams[b].name;
         });
 
         for (int i = 0; i < indices.size(); i++) {
-            ranking.push_back({teamNames[indices[i]], i + 1});
+            ranking.push_back({indices[i], i + 1});
+        }
+        if (orderedKeys) {
+            orderedKeys->resize(indices.size());
+            for (int i = 0; i < indices.size(); i++) {
+                (*orderedKeys)[i] = keys[indices[i]];
+            }
         }
     }
 
-    void printScoreboard() {
-        vector<pair<string, int>> ranking;
-        calculateRanking(ranking);
+    void moveTeam(int id, const RankKey& key) {
+        KeyOrder order{&flushedKeys, &teams};
+        vector<int>& from = rankBuckets[flushedKeys[id].solved];
+        from.erase(lower_bound(from.begin(), from.end(), id, order));
+        flushedKeys[id] = key;
+        vector<int>& to = rankBuckets[key.solved];
+        to.insert(upper_bound(to.begin(), to.end(), id, order), id);
+    }
 
-        for (const auto& p : ranking) {
-            const Team& t = teams[p.first];
+    // Refills the buckets from a complete ranking.
+    void resetBuckets(const vector<pair<int, int>>& ranking,
+                      const vector<RankKey>& keys) {
+        for (vector<int>& bucket : rankBuckets) {
+            bucket.clear();
+        }
+        flushedKeys.resize(teams.size());
+        for (int i = 0; i < ranking.size(); i++) {
+            int id = ranking[i].first;
+            flushedKeys[id] = keys[i];
+            rankBuckets[keys[i].solved].push_back(id);
+        }
+        for (int id : changedTeams) {
+            changed[id] = false;
+        }
+        changedTeams.clear();
+        for (int id : pendingTeams) {
+            pending[id] = false;
+        }
+        pendingTeams.clear();
+    }
 
-            int solved = 0, penalty = 0;
-            for (const auto& prob : problemList) {
-                auto it = t.problems.find(prob);
-                if (it != t.problems.end()) {
-                    const ProblemStatus& ps = it->second;
-                    if (ps.solved && ps.wasSolvedBeforeFreeze) {
-                        solved++;
-                        penalty += ps.solveTime + 20 * ps.wrongAttempts;
-                    }
+    // Flushed rank: teams in fuller buckets, then those ahead in its own.
+    int bucketRank(int id) const {
+        int solved = flushedKeys[id].solved;
+        int rank = 1;
+        for (int k = solved + 1; k <= kMaxProblems; k++) {
+            rank += rankBuckets[k].size();
+        }
+        const vector<int>& bucket = rankBuckets[solved];
+        return rank + (lower_bound(bucket.begin(), bucket.end(), id,
+                                   KeyOrder{&flushedKeys, &teams}) -
+                       bucket.begin());
+    }
+
+    // Queries that read the flushed board add this after their info line.
+    void printFrozenWarning() const {
+        if (frozen) {
+            cout << "[Warning]Scoreboard is frozen. The ranking may be inaccurate until it were scrolled.\n";
+        }
+    }
+
+    // Brings lastRanking up to the latest FLUSH before it is read.
+    void observeRanking() {
+        if (pendingTeams.empty()) {
+            return;
+        }
+        for (int id : pendingTeams) {
+            moveTeam(id, keyAt(id, rankingVersions - 1));
+            pending[id] = false;
+        }
+        pendingTeams.clear();
+        lastRanking.clear();
+        lastRankingKeys.clear();
+        for (int k = kMaxProblems; k >= 0; k--) {
+            for (int id : rankBuckets[k]) {
+                lastRanking.push_back({id, (int)lastRanking.size() + 1});
+                lastRankingKeys.push_back(flushedKeys[id]);
+            }
+        }
+    }
+
+    // A flushed row with its cells, for the snapshot and shared boards.
+    void fillBoardRow(BoardRow& row, int id, int rank,
+                      const RankKey& key) const {
+        row.team = id;
+        row.rank = rank;
+        row.solved = key.solved;
+        row.penalty = key.penalty;
+        for (int p = 0; p < kMaxProblems; p++) {
+            BoardCell& cell = row.cells[p];
+            if (p < problemCount) {
+                cell.solveTime = flushedCells.solveTime(p, id);
+                cell.wrongAttempts = flushedCells.wrongAttempts(p, id);
+                cell.frozenSubmissions =
+                    flushedFrozenCounts[p * flushedCells.stride + id];
+            } else {
+                cell = BoardCell();
+            }
+        }
+    }
+
+    // Seqlock write: readers retry while the sequence is odd or changed.
+    // With `layout` the header fields and names are rewritten as well.
+    void writeSharedBoard(bool layout = false) {
+        if (!sharedBoard) {
+            return;
+        }
+        observeRanking();
+        uint32_t sequence = sharedBoard->sequence.load(memory_order_relaxed);
+        if (sequence & 1) {
+            sequence++;  // left odd by a writer that died mid-publish
+        }
+        sharedBoard->sequence.store(sequence + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        if (layout) {
+            copy(kSharedBoardMagic, kSharedBoardMagic + 8, sharedBoard->magic);
+            sharedBoard->version = kSharedBoardVersion;
+            sharedBoard->rowSize = sizeof(BoardRow);
+            sharedBoard->teamCount = teams.size();
+            sharedBoard->problemCount = problemCount;
+            char* names = const_cast<char*>(sharedBoardName(sharedBoard, 0));
+            fill(names, names + teams.size() * kBoardNameSize, 0);
+            for (int i = 0; i < teams.size(); i++) {
+                teams[i].name.copy(names + i * kBoardNameSize,
+                                   kBoardNameSize - 1);
+            }
+        }
+        sharedBoard->boardVersion = rankingVersions - 1;
+        BoardRow* rows = reinterpret_cast<BoardRow*>(sharedBoard + 1);
+        for (int i = 0; i < lastRanking.size(); i++) {
+            fillBoardRow(rows[i], lastRanking[i].first, lastRanking[i].second,
+                         lastRankingKeys[i]);
+        }
+
+        sharedBoard->sequence.store(sequence + 2, memory_order_release);
+    }
+
+    void markCellsUnflushed(int id) {
+        if (!cellsUnflushed[id]) {
+            cellsUnflushed[id] = true;
+            unflushedCellTeams.push_back(id);
+        }
+    }
+
+    void flushCells() {
+        for (int id : unflushedCellTeams) {
+            for (int p = 0; p < problemCount; p++) {
+                flushedCells.solveTime(p, id) = cells.solveTime(p, id);
+                flushedCells.wrongAttempts(p, id) = cells.wrongAttempts(p, id);
+                flushedFrozenCounts[p * flushedCells.stride + id] =
+                    teams[id].frozenSubs[p].size();
+            }
+            cellsUnflushed[id] = false;
+        }
+        unflushedCellTeams.clear();
+    }
+
+    void markRowDirty(int id) {
+        if (!rowDirty[id]) {
+            rowDirty[id] = true;
+            dirtyRows.push_back(id);
+        }
+    }
+
+    // Prints the board, or in delta mode only its rows whose rank or cells
+    // changed since the last board printed; it becomes the new baseline.
+    void printBoardRows(const vector<pair<int, int>>& ranking,
+                        const vector<RankKey>& keys) {
+        for (int i = 0; i < ranking.size(); i++) {
+            int id = ranking[i].first;
+            int rank = ranking[i].second;
+            if (!deltaOutput || rowDirty[id] || shownRanks[id] != rank) {
+                kernels->printRow(cells, teams[id], id, rank, keys[i]);
+            }
+            shownRanks[id] = rank;
+        }
+        for (int id : dirtyRows) {
+            rowDirty[id] = false;
+        }
+        dirtyRows.clear();
+    }
+
+    void printScoreboard(const vector<pair<int, int>>& ranking,
+                         const vector<RankKey>& keys, bool revealFrozen) {
+        PrintRowFn printRow =
+            revealFrozen ? kernels->printRevealedRow : kernels->printRow;
+        for (int i = 0; i < ranking.size(); i++) {
+            int id = ranking[i].first;
+            printRow(cells, teams[id], id, ranking[i].second, keys[i]);
+        }
+    }
+
+    // Runs a whole scroll on copies of the ranking keys and the frozen cell
+    // summaries, so it can be replayed without touching the system. The
+    // order is kept in two trees: every team, with order statistics for
+    // ranks, and teams with frozen cells.
+    class ScrollEngine {
+    public:
+        struct Event {
+            int team;
+            FrozenCell cell;
+            int oldRank;
+            int newRank;
+            int replaced;  // team overtaken at the new rank, -1 if none
+            int solved;
+            int penalty;
+        };
+
+        ScrollEngine(const ICPCSystem& system,
+                     const vector<pair<int, int>>& ranking,
+                     const vector<RankKey>& orderedKeys)
+            : system(system), keys(system.teams.size()),
+              pending(system.teams.size()), revealedKeys(system.teams.size()),
+              order(KeyOrder{&keys, &system.teams}),
+              withFrozen(KeyOrder{&keys, &system.teams}) {
+            for (int i = 0; i < ranking.size(); i++) {
+                keys[ranking[i].first] = orderedKeys[i];
+            }
+            // Each team's reveals depend only on its own cells, so their
+            // keys are worked out up front in parallel; the scroll itself
+            // then only moves teams through the trees.
+            parallelFor(system.teams.size(), [this](int begin, int end) {
+                for (int id = begin; id < end; id++) {
+                    precompute(id);
+                }
+            });
+            for (const auto& row : ranking) {
+                order.insert(row.first);
+                if (!pending[row.first].empty()) {
+                    withFrozen.insert(withFrozen.end(), row.first);
                 }
             }
+        }
 
-            cout << t.name << " " << p.second << " " << solved << " " << penalty;
-
-            for (const auto& prob : problemList) {
-                cout << " ";
-                auto it = t.problems.find(prob);
-                if (it != t.problems.end()) {
-                    const ProblemStatus& ps = it->second;
-                    if (ps.solved && ps.wasSolvedBeforeFreeze) {
-                        cout << "+";
-                        if (ps.wrongAttempts > 0) {
-                            cout << ps.wrongAttempts;
-                        }
-                    } else if (!ps.frozenSubs.empty()) {
-                        int wrongBefore = ps.wrongAttempts;
-                        if (wrongBefore > 0) {
-                            cout << "-";
-                        }
-                        cout << wrongBefore << "/" << ps.frozenSubs.size();
-                    } else if (ps.wrongAttempts > 0) {
-                        cout << "-" << ps.wrongAttempts;
-                    } else {
-                        cout << ".";
-                    }
-                } else {
-                    cout << ".";
+        // Performs the next unfreeze in scroll order and describes it in
+        // `event`; returns false once no team has frozen cells left.
+        bool next(Event& event) {
+            if (withFrozen.empty()) {
+                return false;
+            }
+            auto lowest = prev(withFrozen.end());
+            int id = *lowest;
+            withFrozen.erase(lowest);
+
+            int rank = order.order_of_key(id) + 1;
+            event = {id, pending[id].back(), rank, rank, -1, 0, 0};
+            pending[id].pop_back();
+            RankKey& key = keys[id];
+            if (event.cell.solveTime > 0) {
+                // The key only improves, so the team stays ahead of its
+                // lower neighbour; it moves only if it now beats the upper
+                // one. Otherwise the tree stays valid with the key updated
+                // in place.
+                auto self = order.find_by_order(rank - 1);
+                key = revealedKeys[id].back();
+                revealedKeys[id].pop_back();
+                if (rank > 1 && order.get_cmp_fn()(id, *prev(self))) {
+                    order.erase(self);
+                    order.insert(id);
+                    event.newRank = order.order_of_key(id) + 1;
+                    event.replaced = *order.find_by_order(event.newRank);
+                }
+            }
+            event.solved = key.solved;
+            event.penalty = key.penalty;
+
+            if (!pending[id].empty()) {
+                withFrozen.insert(id);
+            }
+            return true;
+        }
+
+        void finalRanking(vector<pair<int, int>>& ranking,
+                          vector<RankKey>& orderedKeys) const {
+            ranking.clear();
+            orderedKeys.clear();
+            for (int id : order) {
+                ranking.push_back({id, (int)ranking.size() + 1});
+                orderedKeys.push_back(keys[id]);
+            }
+        }
+
+    private:
+        // Collects the team's frozen cells and, for each accepted one, its
+        // key once that cell and all before it are revealed. Both lists
+        // are consumed from the back.
+        void precompute(int id) {
+            system.kernels->collectFrozenCells(
+                system.cells, system.teams[id], id, pending[id]);
+            RankKey key = keys[id];
+            vector<RankKey>& revealed = revealedKeys[id];
+            for (auto cell = pending[id].rbegin(); cell != pending[id].rend();
+                 ++cell) {
+                if (cell->solveTime == 0) {
+                    continue;
+                }
+                key.solved++;
+                key.penalty +=
+                    Rules::penalty(cell->solveTime, cell->wrongAttempts);
+                if (Rules::kCompareSolveTimes) {
+                    insertSolveTime(key.times, cell->solveTime);
+                }
+                revealed.push_back(key);
+            }
+            reverse(revealed.begin(), revealed.end());
+        }
+
+        const ICPCSystem& system;
+        vector<RankKey> keys;
+        vector<vector<FrozenCell>> pending;
+        vector<vector<RankKey>> revealedKeys;
+        RankTree order;
+        set<int, KeyOrder> withFrozen;
+    };
+
+    // Prints the SCROLL output for the current state. With `commit` the
+    // unfreezes are applied and the result becomes the flushed ranking;
+    // without it nothing in the system changes. Output is flushed after
+    // the opening board and after every ranking change, so a display can
+    // follow the scroll while it is being computed.
+    void playScroll(bool commit) {
+        vector<pair<int, int>> ranking;
+        vector<RankKey> keys;
+        calculateRanking(ranking, &keys);
+        if (commit) {
+            printBoardRows(ranking, keys);
+        } else {
+            printScoreboard(ranking, keys, false);
+        }
+        cout.flush();
+
+        ScrollFramesHeader header = {};
+        if (scrollExport.is_open()) {
+            copy(kScrollFramesMagic, kScrollFramesMagic + 8, header.magic);
+            header.version = kScrollFramesVersion;
+            header.frameSize = sizeof(ScrollFrame);
+            header.teamCount = teams.size();
+            header.problemCount = problemCount;
+            scrollExport.write(reinterpret_cast<const char*>(&header),
+                               sizeof(header));
+        }
+
+        ScrollEngine engine(*this, ranking, keys);
+        typename ScrollEngine::Event event;
+        while (engine.next(event)) {
+            if (scrollExport.is_open()) {
+                ScrollFrame frame = {event.team,    event.cell.problem,
+                                     event.oldRank, event.newRank,
+                                     event.solved,  event.penalty};
+                scrollExport.write(reinterpret_cast<const char*>(&frame),
+                                   sizeof(frame));
+                header.frameCount++;
+            }
+            if (commit) {
+                const FrozenCell& cell = event.cell;
+                cells.wrongAttempts(cell.problem, event.team) =
+                    cell.wrongAttempts;
+                if (cell.solveTime > 0) {
+                    markSolved(cell.problem, event.team, cell.solveTime);
                 }
+                teams[event.team].frozenSubs[cell.problem].clear();
+                markRowDirty(event.team);
+                markCellsUnflushed(event.team);
+            }
+            if (event.replaced >= 0) {
+                cout << teams[event.team].name << " "
+                     << teams[event.replaced].name << " " << event.solved
+                     << " " << event.penalty << "\n";
+                cout.flush();
             }
-            cout << "\n";
+        }
+
+        if (scrollExport.is_open()) {
+            scrollExport.seekp(0);
+            scrollExport.write(reinterpret_cast<const char*>(&header),
+                               sizeof(header));
+            scrollExport.close();
+        }
+
+        engine.finalRanking(ranking, keys);
+        if (commit) {
+            printBoardRows(ranking, keys);
+        } else {
+            printScoreboard(ranking, keys, true);
+        }
+        if (commit) {
+            // With everything revealed, the board must match the shadow.
+            assert(equal(trueOrder.begin(), trueOrder.end(), ranking.begin(),
+                         [](int id, const pair<int, int>& row) {
+                             return id == row.first;
+                         }));
+            lastRanking.swap(ranking);
+            lastRankingKeys.swap(keys);
         }
     }
 
 public:
     ICPCSystem() : started(false), frozen(false), durationTime(0),
-                   problemCount(0) {}
+                   problemCount(0), kernels(selectKernels(0)),
+                   rankingVersions(0), historyRoot(0), historyOwned(1),
+                   deltaOutput(false), trueOrder(KeyOrder{&trueKeys, &teams}),
+                   sharedBoard(nullptr), sharedBoardBytes(0) {
+        fill(medalCounts, medalCounts + kMedalCount, 4);
+        sites.push_back({"LOCAL", nullptr, 0, uint32_t(-1), {}, {}, {}});
+    }
+
+    ~ICPCSystem() {
+        if (sharedBoard) {
+            munmap(sharedBoard, sharedBoardBytes);
+        }
+        for (const Site& site : sites) {
+            if (site.shared) {
+                munmap(const_cast<SharedBoardHeader*>(site.shared), site.bytes);
+            }
+        }
+    }
 
     void addTeam(const string& name) {
         if (started) {
             cout << "[Error]Add failed: competition has started.\n";
-        } else if (teams.count(name)) {
+        } else if (teamIndex.count(name)) {
             cout << "[Error]Add failed: duplicated team name.\n";
         } else {
-            teams[name] = Team(name);
-            teamNames.push_back(name);
+            int id = teams.size();
+            teamIndex[name] = id;
+            teams.push_back(Team(name));
+            // Before START the board is every team in name order.
+            flushedKeys.push_back(RankKey());
+            vector<int>& bucket = rankBuckets[0];
+            bucket.insert(upper_bound(bucket.begin(), bucket.end(), id,
+                                      KeyOrder{&flushedKeys, &teams}),
+                          id);
             cout << "[Info]Add successfully.\n";
         }
     }
@@ -178,38 +1451,87 @@ public:
             started = true;
             durationTime = duration;
             problemCount = problems;
-            problemList.reserve(problems);
-            for (int i = 0; i < problems; i++) {
-                problemList.push_back(string(1, 'A' + i));
+            kernels = selectKernels(problems);
+            cells.reset(problems, teams.size());
+            flushedCells.reset(problems, teams.size());
+            flushedFrozenCounts.assign(problems * flushedCells.stride, 0);
+            cellsUnflushed.assign(teams.size(), false);
+            trueCells.reset(problems, teams.size());
+            trueKeys.assign(teams.size(), RankKey());
+            for (int i = 0; i < teams.size(); i++) {
+                trueOrder.insert(i);
             }
+            // Nobody has solved anything yet, so this is the name order the
+            // board shows before the first flush.
+            calculateRanking(lastRanking, &lastRankingKeys);
+            changed.assign(teams.size(), false);
+            pending.assign(teams.size(), false);
+            rowDirty.assign(teams.size(), false);
+            shownRanks.resize(teams.size());
+            for (const auto& row : lastRanking) {
+                shownRanks[row.first] = row.second;
+            }
+            resetBuckets(lastRanking, lastRankingKeys);
+            solveHistory.resize(teams.size());
+            historyNodes.assign(1, HistoryNode());
+            for (int i = 0; i < teams.size(); i++) {
+                historyRoot = insertHistory(historyRoot, newHistoryNode(i, 0));
+            }
+            closeRankingVersion();
             cout << "[Info]Competition starts.\n";
         }
     }
 
     void submit(const string& problem, const string& teamName,
                 const string& status, int time) {
-        Team& team = teams[teamName];
-        team.submissions.push_back({problem, status, time});
-
-        ProblemStatus& ps = team.problems[problem];
-
-        if (frozen && !ps.wasSolvedBeforeFreeze) {
-            ps.frozenSubs.push_back({problem, status, time});
-        } else if (!ps.solved) {
-            if (status == "Accepted") {
-                ps.solved = true;
-                ps.solveTime = time;
-                ps.wasSolvedBeforeFreeze = true;
-            } else {
-                ps.wrongAttempts++;
-            }
+        int id = teamIndex[teamName];
+        int p = problem[0] - 'A';
+        int s = parseStatus(status);
+        int index = submissionLog.size();
+        Team& team = teams[id];
+        Submission sub = {id, p, s, time,
+                          team.submissions.empty() ? -1 : team.submissions.back(),
+                          team.lastByProblem[p], team.lastByStatus[s],
+                          team.lastByProblemStatus[p][s]};
+        team.submissions.push_back(index);
+        team.lastByProblem[p] = index;
+        team.lastByStatus[s] = index;
+        team.lastByProblemStatus[p][s] = index;
+        problemSubmissions[p].push_back(index);
+        submissionLog.push_back(sub);
+        problemStats[p].attempts++;
+        updateTrueRanking(sub);
+
+        if (cells.solveTime(p, id) > 0) {
+            return;
+        }
+        markRowDirty(id);
+        markCellsUnflushed(id);
+        if (frozen) {
+            team.frozenSubs[p].push_back(sub);
+        } else if (sub.status == kAccepted) {
+            markSolved(p, id, time);
+        } else {
+            cells.wrongAttempts(p, id)++;
         }
     }
 
-    void flush(bool silent = false) {
-        calculateRanking(lastRanking);
-        if (!silent) {
-            cout << "[Info]Flush scoreboard.\n";
+    void flush() {
+        for (int id : changedTeams) {
+            changed[id] = false;
+            if (!pending[id]) {
+                pending[id] = true;
+                pendingTeams.push_back(id);
+            }
+        }
+        changedTeams.clear();
+        flushCells();
+        closeRankingVersion();
+        writeSharedBoard();
+        cout << "[Info]Flush scoreboard.\n";
+        if (deltaOutput) {
+            observeRanking();
+            printBoardRows(lastRanking, lastRankingKeys);
         }
     }
 
@@ -218,15 +1540,6 @@ public:
             cout << "[Error]Freeze failed: scoreboard has been frozen.\n";
         } else {
             frozen = true;
-            for (auto& tp : teams) {
-                Team& t = tp.second;
-                for (auto& pp : t.problems) {
-                    ProblemStatus& ps = pp.second;
-                    if (ps.solved) {
-                        ps.wasSolvedBeforeFreeze = true;
-                    }
-                }
-            }
             cout << "[Info]Freeze scoreboard.\n";
         }
     }
@@ -238,153 +1551,611 @@ public:
         }
 
         cout << "[Info]Scroll scoreboard.\n";
+        playScroll(true);
+        resetBuckets(lastRanking, lastRankingKeys);
+        flushCells();
+        closeRankingVersion();
+        writeSharedBoard();
 
-        flush(true);
-        printScoreboard();
+        frozen = false;
+    }
 
-        unordered_map<string, int> rankMap;
-        for (const auto& p : lastRanking) {
-            rankMap[p.first] = p.second;
+    void exportScroll(const string& path) {
+        scrollExport.close();
+        scrollExport.clear();
+        scrollExport.open(path.c_str(), ios::binary | ios::trunc);
+        if (!scrollExport.is_open()) {
+            cout << "[Error]Export scroll failed: cannot open the file.\n";
+            return;
         }
+        cout << "[Info]Scroll frames will be exported.\n";
+    }
 
-        while (true) {
-            bool hasFrozen = false;
-            string lowestTeam = "";
-            int lowestRank = 0;
+    // The segment is left in place after the engine exits so readers keep
+    // the final board; it is replaced by the next PUBLISH_BOARD.
+    void publishBoard(const string& name) {
+        if (!started) {
+            cout << "[Error]Publish board failed: competition has not started.\n";
+            return;
+        }
 
-            for (const auto& name : teamNames) {
-                const Team& t = teams[name];
-                bool teamHasFrozen = false;
-                for (const auto& prob : problemList) {
-                    auto it = t.problems.find(prob);
-                    if (it != t.problems.end() && !it->second.frozenSubs.empty()) {
-                        teamHasFrozen = true;
-                        break;
-                    }
-                }
-                if (teamHasFrozen) {
-                    int rank = rankMap[name];
-                    if (rank > lowestRank) {
-                        lowestRank = rank;
-                        lowestTeam = name;
-                    }
-                    hasFrozen = true;
-                }
+        // An existing segment is never shrunk, since readers may map all
+        // of it.
+        size_t size = sharedBoardSize(teams.size());
+        void* mapped = MAP_FAILED;
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd >= 0) {
+            struct stat st;
+            if (fstat(fd, &st) == 0 &&
+                (st.st_size >= size || ftruncate(fd, size) == 0)) {
+                size = max<size_t>(size, st.st_size);
+                mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, fd, 0);
             }
+            close(fd);
+        }
+        if (mapped == MAP_FAILED) {
+            cout << "[Error]Publish board failed: cannot map the segment.\n";
+            return;
+        }
 
-            if (!hasFrozen) break;
+        if (sharedBoard) {
+            munmap(sharedBoard, sharedBoardBytes);
+        }
+        // A new segment is zero-filled, so its sequence starts even; a
+        // replaced one keeps counting, and readers of either see the
+        // header rewritten only while the sequence is odd.
+        sharedBoard = static_cast<SharedBoardHeader*>(mapped);
+        sharedBoardBytes = size;
+        writeSharedBoard(true);
+        cout << "[Info]Board will be published.\n";
+    }
 
-            Team& t = teams[lowestTeam];
-            string unfreezeProb = "";
-            for (const auto& prob : problemList) {
-                auto it = t.problems.find(prob);
-                if (it != t.problems.end() && !it->second.frozenSubs.empty()) {
-                    unfreezeProb = prob;
-                    break;
-                }
+    void addSite(const string& segment) {
+        void* mapped = MAP_FAILED;
+        size_t bytes = 0;
+        int fd = shm_open(segment.c_str(), O_RDONLY, 0);
+        if (fd >= 0) {
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size >= sizeof(SharedBoardHeader)) {
+                bytes = st.st_size;
+                mapped = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
             }
+            close(fd);
+        }
+        const SharedBoardHeader* shared =
+            static_cast<const SharedBoardHeader*>(mapped);
+        if (mapped != MAP_FAILED &&
+            (!equal(kSharedBoardMagic, kSharedBoardMagic + 8, shared->magic) ||
+             shared->version != kSharedBoardVersion ||
+             shared->rowSize != sizeof(BoardRow) ||
+             sharedBoardSize(shared->teamCount) > bytes)) {
+            munmap(mapped, bytes);
+            mapped = MAP_FAILED;
+        }
+        if (mapped == MAP_FAILED) {
+            cout << "[Error]Add site failed: cannot map the segment.\n";
+            return;
+        }
 
-            ProblemStatus& ps = t.problems[unfreezeProb];
-            for (const auto& sub : ps.frozenSubs) {
-                if (sub.status == "Accepted" && !ps.solved) {
-                    ps.solved = true;
-                    ps.solveTime = sub.time;
-                    ps.wasSolvedBeforeFreeze = true;
-                } else if (sub.status != "Accepted" && !ps.solved) {
-                    ps.wrongAttempts++;
-                }
-            }
-            ps.frozenSubs.clear();
+        // The sequence is even once published, so an odd mark forces the
+        // first read.
+        sites.push_back({segment, shared, bytes, 1, {}, {}, {}});
+        cout << "[Info]Add site successfully.\n";
+    }
 
-            int oldRank = lowestRank;
-            calculateRanking(lastRanking);
-            rankMap.clear();
-            for (const auto& p : lastRanking) {
-                rankMap[p.first] = p.second;
+    // Re-reads a site if it has published since the last read; returns
+    // whether it changed.
+    bool refreshSite(Site& site) {
+        if (!site.shared) {
+            observeRanking();
+            uint32_t version = rankingVersions;
+            if (site.sequence == version) {
+                return false;
             }
+            site.sequence = version;
+            site.teamNames.clear();
+            for (const auto& row : lastRanking) {
+                site.teamNames.push_back(teams[row.first].name.c_str());
+            }
+            site.keys = lastRankingKeys;
+            return true;
+        }
 
-            int newRank = rankMap[lowestTeam];
-
-            if (newRank < oldRank) {
-                TeamRankInfo info = getTeamRankInfo(lowestTeam);
-
-                string replacedTeam = "";
-                for (const auto& p : lastRanking) {
-                    if (p.second == newRank + 1) {
-                        replacedTeam = p.first;
-                        break;
+        if (site.shared->sequence.load(memory_order_acquire) == site.sequence) {
+            return false;
+        }
+        size_t capacity = sharedBoardCapacity(site.bytes);
+        vector<BoardRow> rows(capacity);
+        vector<char> nameTable(capacity * kBoardNameSize);
+        SharedBoardInfo info;
+        SharedBoardRead read = readSharedBoard(
+            site.shared, site.bytes, rows.data(), nameTable.data(), info);
+        if (read == kSharedBoardBusy) {
+            return false;  // keep the last board read until the site recovers
+        }
+        site.sequence = info.sequence;
+        site.nameTable.swap(nameTable);
+        site.teamNames.clear();
+        site.keys.clear();
+        if (read == kSharedBoardOutgrown) {
+            return true;  // republished for more teams; needs ADD_SITE again
+        }
+        site.keys.assign(info.teamCount, RankKey());
+        for (int i = 0; i < info.teamCount; i++) {
+            site.teamNames.push_back(&site.nameTable[rows[i].team *
+                                                     kBoardNameSize]);
+            RankKey& key = site.keys[i];
+            key.solved = rows[i].solved;
+            key.penalty = rows[i].penalty;
+            if (Rules::kCompareSolveTimes) {
+                for (int p = 0; p < info.problemCount; p++) {
+                    if (rows[i].cells[p].solveTime > 0) {
+                        insertSolveTime(key.times, rows[i].cells[p].solveTime);
                     }
                 }
+            }
+        }
+        return true;
+    }
+
+    // Replaces site s's rows in the merged standings with its fresh run:
+    // the other sites' rows are already in order, so this is one linear
+    // merge. Ties across sites go by team name, then by site order.
+    void remergeSite(int s) {
+        auto ahead = [&](const pair<int, int>& a, const pair<int, int>& b) {
+            int cmp = Rules::compare(sites[a.first].keys[a.second],
+                                     sites[b.first].keys[b.second]);
+            if (cmp != 0) return cmp < 0;
+            cmp = strcmp(sites[a.first].teamNames[a.second],
+                         sites[b.first].teamNames[b.second]);
+            if (cmp != 0) return cmp < 0;
+            return a.first < b.first;
+        };
+
+        vector<pair<int, int>> others, run;
+        for (const auto& entry : mergedBoard) {
+            if (entry.first != s) {
+                others.push_back(entry);
+            }
+        }
+        for (int i = 0; i < sites[s].keys.size(); i++) {
+            run.push_back({s, i});
+        }
+        mergedBoard.clear();
+        merge(others.begin(), others.end(), run.begin(), run.end(),
+              back_inserter(mergedBoard), ahead);
+    }
 
-                cout << lowestTeam << " " << replacedTeam << " " << info.solved << " " << info.penalty << "\n";
+    void queryMergedBoard() {
+        for (int s = 0; s < sites.size(); s++) {
+            if (refreshSite(sites[s])) {
+                remergeSite(s);
             }
         }
 
-        printScoreboard();
+        cout << "[Info]Complete query merged board.\n";
+        for (int i = 0; i < mergedBoard.size(); i++) {
+            const Site& site = sites[mergedBoard[i].first];
+            int index = mergedBoard[i].second;
+            cout << site.name << " " << site.teamNames[index] << " " << i + 1
+                 << " " << site.keys[index].solved << " "
+                 << site.keys[index].penalty << "\n";
+        }
+    }
 
-        frozen = false;
+    void previewScroll() {
+        if (!frozen) {
+            cout << "[Error]Scroll preview failed: scoreboard has not been frozen.\n";
+            return;
+        }
+
+        cout << "[Info]Preview scroll scoreboard.\n";
+        playScroll(false);
     }
 
     void queryRanking(const string& name) {
-        if (!teams.count(name)) {
+        auto found = teamIndex.find(name);
+        if (found == teamIndex.end()) {
             cout << "[Error]Query ranking failed: cannot find the team.\n";
             return;
         }
 
+        observeRanking();
         cout << "[Info]Complete query ranking.\n";
-        if (frozen) {
-            cout << "[Warning]Scoreboard is frozen. The ranking may be inaccurate until it were scrolled.\n";
+        printFrozenWarning();
+
+        int rank = bucketRank(found->second);
+        cout << name << " NOW AT RANKING " << rank << "\n";
+    }
+
+    void queryTrueRanking(const string& name) {
+        auto found = teamIndex.find(name);
+        if (found == teamIndex.end()) {
+            cout << "[Error]Query ranking failed: cannot find the team.\n";
+            return;
         }
 
-        int rank = 0;
-        if (!lastRanking.empty()) {
-            for (const auto& p : lastRanking) {
-                if (p.first == name) {
-                    rank = p.second;
-                    break;
+        cout << "[Info]Complete query true ranking.\n";
+        cout << name << " IS TRULY AT RANKING "
+             << trueOrder.order_of_key(found->second) + 1 << "\n";
+    }
+
+    // Rank a score would take on the last flushed board, ahead of every team
+    // it ties with, found by binary search over the flushed keys.
+    void queryHypothetical(int solved, int penalty, vector<int> times) {
+        cout << "[Info]Complete query hypothetical ranking.\n";
+        printFrozenWarning();
+
+        RankKey key;
+        key.solved = solved;
+        key.penalty = penalty;
+        sort(times.rbegin(), times.rend());
+        times.resize(kTimeSlots, 0);
+        copy(times.begin(), times.end(), key.times);
+
+        observeRanking();
+        auto better = partition_point(
+            lastRankingKeys.begin(), lastRankingKeys.end(),
+            [&](const RankKey& k) { return Rules::compare(k, key) < 0; });
+        cout << "HYPOTHETICAL WOULD BE AT RANKING "
+             << better - lastRankingKeys.begin() + 1 << "\n";
+    }
+
+    void queryCountSolved(int k) {
+        observeRanking();
+        cout << "[Info]Complete query count.\n";
+        printFrozenWarning();
+
+        int count = 0;
+        for (int s = max(k, 0); s <= kMaxProblems; s++) {
+            count += rankBuckets[s].size();
+        }
+        cout << count << " TEAMS SOLVED AT LEAST " << k << "\n";
+    }
+
+    // Penalty is the first key within a bucket, so the range is two binary
+    // searches.
+    void queryCountPenalty(int k, int low, int high) {
+        observeRanking();
+        cout << "[Info]Complete query count.\n";
+        printFrozenWarning();
+
+        int count = 0;
+        if (k >= 0 && k <= kMaxProblems && low <= high) {
+            const vector<int>& bucket = rankBuckets[k];
+            auto first = lower_bound(
+                bucket.begin(), bucket.end(), low,
+                [&](int id, int p) { return flushedKeys[id].penalty < p; });
+            auto last = upper_bound(
+                first, bucket.end(), high,
+                [&](int p, int id) { return p < flushedKeys[id].penalty; });
+            count = last - first;
+        }
+        cout << count << " TEAMS SOLVED " << k << " WITH PENALTY " << low
+             << " TO " << high << "\n";
+    }
+
+    // The flushed board as JSON or CSV. Names need no escaping, so each
+    // team's leading fragment is built once and reused for every export.
+    void exportBoard(const string& format, const string& path) {
+        bool json = format == "JSON";
+        if (!json && format != "CSV") {
+            cout << "[Error]Export board failed: unknown format.\n";
+            return;
+        }
+        ofstream file(path.c_str(), ios::binary | ios::trunc);
+        if (!file.is_open()) {
+            cout << "[Error]Export board failed: cannot open the file.\n";
+            return;
+        }
+
+        observeRanking();
+        vector<string>& fragments = json ? jsonRowFragments : csvRowFragments;
+        if (fragments.size() != teams.size()) {
+            fragments.resize(teams.size());
+            for (int i = 0; i < teams.size(); i++) {
+                fragments[i] = json ? "{\"team\":\"" + teams[i].name +
+                                          "\",\"rank\":"
+                                    : teams[i].name + ",";
+            }
+        }
+
+        BlockWriter out(file);
+        if (json) {
+            out.append("{\"problems\":");
+            out.appendInt(problemCount);
+            out.append(",\"rows\":[");
+        } else {
+            out.append("team,rank,solved,penalty");
+            for (int p = 0; p < problemCount; p++) {
+                out.append(',');
+                out.append(char('A' + p));
+            }
+            out.append('\n');
+        }
+        for (int i = 0; i < lastRanking.size(); i++) {
+            int id = lastRanking[i].first;
+            const RankKey& key = lastRankingKeys[i];
+            if (json && i > 0) {
+                out.append(',');
+            }
+            out.append(fragments[id]);
+            out.appendInt(lastRanking[i].second);
+            out.append(json ? ",\"solved\":" : ",");
+            out.appendInt(key.solved);
+            out.append(json ? ",\"penalty\":" : ",");
+            out.appendInt(key.penalty);
+            if (json) {
+                out.append(",\"cells\":[");
+            }
+            for (int p = 0; p < problemCount; p++) {
+                if (json) {
+                    out.append(p > 0 ? ",\"" : "\"");
+                } else {
+                    out.append(',');
+                }
+                appendCell(out, flushedCells.wrongAttempts(p, id),
+                           flushedCells.solveTime(p, id),
+                           flushedFrozenCounts[p * flushedCells.stride + id]);
+                if (json) {
+                    out.append('"');
                 }
             }
+            out.append(json ? "]}" : "\n");
+        }
+        if (json) {
+            out.append("]}\n");
+        }
+        cout << "[Info]Export board.\n";
+    }
+
+    void exportSnapshot(const string& path) {
+        ofstream file(path.c_str(), ios::binary | ios::trunc);
+        if (!file.is_open()) {
+            cout << "[Error]Export snapshot failed: cannot open the file.\n";
+            return;
+        }
+
+        observeRanking();
+        BoardSnapshotHeader header = {};
+        copy(kBoardSnapshotMagic, kBoardSnapshotMagic + 8, header.magic);
+        header.version = kBoardSnapshotVersion;
+        header.rowSize = sizeof(BoardRow);
+        header.nameSize = kBoardNameSize;
+        header.teamCount = lastRanking.size();
+        header.problemCount = problemCount;
+        header.boardVersion = rankingVersions - 1;
+        header.rowsOffset = sizeof(header);
+        header.namesOffset =
+            header.rowsOffset + header.teamCount * sizeof(BoardRow);
+
+        BlockWriter out(file);
+        out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        BoardRow row;
+        for (int i = 0; i < lastRanking.size(); i++) {
+            fillBoardRow(row, lastRanking[i].first, lastRanking[i].second,
+                         lastRankingKeys[i]);
+            out.append(reinterpret_cast<const char*>(&row), sizeof(row));
+        }
+        for (int i = 0; i < header.teamCount; i++) {
+            char name[kBoardNameSize] = {};
+            teams[i].name.copy(name, kBoardNameSize - 1);
+            out.append(name, sizeof(name));
+        }
+        cout << "[Info]Export snapshot.\n";
+    }
+
+    void setBoardOutput(const string& mode) {
+        if (mode == "FULL" || mode == "DELTA") {
+            deltaOutput = mode == "DELTA";
+            cout << "[Info]Set board output.\n";
         } else {
-            vector<string> sortedNames = teamNames;
-            sort(sortedNames.begin(), sortedNames.end());
-            for (int i = 0; i < sortedNames.size(); i++) {
-                if (sortedNames[i] == name) {
-                    rank = i + 1;
+            cout << "[Error]Set board output failed: unknown mode.\n";
+        }
+    }
+
+    void setMedals(int gold, int silver, int bronze) {
+        if (gold < 0 || silver < 0 || bronze < 0) {
+            cout << "[Error]Set medals failed: invalid count.\n";
+            return;
+        }
+        medalCounts[0] = gold;
+        medalCounts[1] = silver;
+        medalCounts[2] = bronze;
+        cout << "[Info]Set medals.\n";
+    }
+
+    // Each medal line falls after its cumulative count on the flushed
+    // board and moves down past teams tied with the last medallist on
+    // every ranking key. Teams without a solve get no medal.
+    void queryAwards() {
+        observeRanking();
+        cout << "[Info]Complete query awards.\n";
+        printFrozenWarning();
+
+        int end = 0;
+        for (int m = 0; m < kMedalCount; m++) {
+            int begin = end;
+            end = min<int>(begin + medalCounts[m], lastRanking.size());
+            while (end > begin && lastRankingKeys[end - 1].solved == 0) {
+                end--;
+            }
+            while (end > begin && end < lastRanking.size() &&
+                   Rules::compare(lastRankingKeys[end - 1],
+                                  lastRankingKeys[end]) == 0) {
+                end++;
+            }
+
+            cout << kMedalNames[m];
+            if (end > begin) {
+                cout << " RANKS " << begin + 1 << " TO " << end << " CUTOFF "
+                     << lastRankingKeys[end - 1].solved << " "
+                     << lastRankingKeys[end - 1].penalty << "\n";
+            } else {
+                cout << " NONE\n";
+            }
+        }
+        for (int p = 0; p < problemCount; p++) {
+            const ProblemStats& stats = problemStats[p];
+            cout << "FIRST_TO_SOLVE " << char('A' + p) << " ";
+            if (stats.firstSolver >= 0) {
+                cout << teams[stats.firstSolver].name << " "
+                     << stats.firstSolveTime << "\n";
+            } else {
+                cout << "- -\n";
+            }
+        }
+    }
+
+    void queryRankingAt(const string& name, int version) {
+        auto found = teamIndex.find(name);
+        if (found == teamIndex.end()) {
+            cout << "[Error]Query ranking failed: cannot find the team.\n";
+            return;
+        }
+        if (version < 0 || version >= rankingVersions) {
+            cout << "[Error]Query ranking failed: cannot find the flush.\n";
+            return;
+        }
+
+        // Ranked behind everything left of the path down to its state.
+        int id = found->second;
+        int solved = solvedAt(id, version);
+        int rank = 1;
+        for (int t = versionRoots[version]; t != 0;) {
+            const HistoryNode& node = historyNodes[t];
+            int cmp = compareStates(id, solved, node.team, node.solved);
+            if (cmp <= 0) {
+                if (cmp == 0) {
+                    rank += historyNodes[node.left].size;
                     break;
                 }
+                t = node.left;
+            } else {
+                rank += historyNodes[node.left].size + 1;
+                t = node.right;
             }
         }
+        cout << "[Info]Complete query ranking.\n";
+        cout << name << " WAS AT RANKING " << rank << " AT FLUSH " << version
+             << "\n";
+    }
 
-        cout << name << " NOW AT RANKING " << rank << "\n";
+    void queryBoardAt(int version) {
+        if (version < 0 || version >= rankingVersions) {
+            cout << "[Error]Query board failed: cannot find the flush.\n";
+            return;
+        }
+
+        cout << "[Info]Complete query board.\n";
+        vector<int> path;
+        int rank = 0;
+        for (int t = versionRoots[version]; t != 0 || !path.empty();) {
+            if (t != 0) {
+                path.push_back(t);
+                t = historyNodes[t].left;
+                continue;
+            }
+            const HistoryNode& node = historyNodes[path.back()];
+            path.pop_back();
+            cout << teams[node.team].name << " " << ++rank << " "
+                 << node.solved << " "
+                 << stateKey(node.team, node.solved, false).penalty << "\n";
+            t = node.right;
+        }
+    }
+
+    void queryProblemStats() {
+        cout << "[Info]Complete query problem stats.\n";
+        for (int p = 0; p < problemCount; p++) {
+            const ProblemStats& stats = problemStats[p];
+            cout << char('A' + p) << " " << stats.attempts << " "
+                 << stats.accepted << " ";
+            if (stats.firstSolver >= 0) {
+                cout << teams[stats.firstSolver].name << " "
+                     << stats.firstSolveTime << "\n";
+            } else {
+                cout << "- -\n";
+            }
+        }
     }
 
     void querySubmission(const string& teamName, const string& problem,
                          const string& status) {
-        if (!teams.count(teamName)) {
+        auto found = teamIndex.find(teamName);
+        if (found == teamIndex.end()) {
             cout << "[Error]Query submission failed: cannot find the team.\n";
             return;
         }
 
         cout << "[Info]Complete query submission.\n";
 
-        const Team& t = teams[teamName];
-        const Submission* found = nullptr;
+        vector<int> heads;
+        int Submission::*link;
+        filterChains(teams[found->second], compileFilter(problem, status),
+                     heads, link);
 
-        for (int i = t.submissions.size() - 1; i >= 0; i--) {
-            const Submission& sub = t.submissions[i];
-            if ((problem == "ALL" || sub.problem == problem) &&
-                (status == "ALL" || sub.status == status)) {
-                found = &sub;
-                break;
-            }
+        if (!heads.empty()) {
+            printSubmission(submissionLog[*max_element(heads.begin(),
+                                                       heads.end())]);
+        } else {
+            cout << "Cannot find any submission.\n";
         }
+    }
 
-        if (found) {
-            cout << teamName << " " << found->problem << " "
-                 << found->status << " " << found->time << "\n";
-        } else {
+    // Newest first, merging the matching chains by log index, so the cost
+    // does not depend on how many submissions fail the filter.
+    void queryLastSubmissions(const string& teamName, int count,
+                              const string& problem, const string& status) {
+        auto found = teamIndex.find(teamName);
+        if (found == teamIndex.end()) {
+            cout << "[Error]Query submission failed: cannot find the team.\n";
+            return;
+        }
+
+        cout << "[Info]Complete query submission.\n";
+
+        vector<int> heads;
+        int Submission::*link;
+        filterChains(teams[found->second], compileFilter(problem, status),
+                     heads, link);
+
+        if (heads.empty() || count <= 0) {
             cout << "Cannot find any submission.\n";
+            return;
+        }
+        priority_queue<int> newest(heads.begin(), heads.end());
+        for (; !newest.empty() && count > 0; count--) {
+            int i = newest.top();
+            newest.pop();
+            printSubmission(submissionLog[i]);
+            if (submissionLog[i].*link >= 0) {
+                newest.push(submissionLog[i].*link);
+            }
+        }
+    }
+
+    void queryTeamSubmissions(const string& teamName, int from, int to) {
+        auto found = teamIndex.find(teamName);
+        if (found == teamIndex.end()) {
+            cout << "[Error]Query submissions failed: cannot find the team.\n";
+            return;
         }
+
+        cout << "[Info]Complete query submissions.\n";
+        printSubmissionsBetween(teams[found->second].submissions, from, to);
+    }
+
+    void queryProblemSubmissions(const string& problem, int from, int to) {
+        int p = problem[0] - 'A';
+        if (p < 0 || p >= problemCount) {
+            cout << "[Error]Query submissions failed: cannot find the problem.\n";
+            return;
+        }
+
+        cout << "[Info]Complete query submissions.\n";
+        printSubmissionsBetween(problemSubmissions[p], from, to);
     }
 
     void end() {
@@ -392,11 +2163,24 @@ public:
     }
 };
 
+// Reads the "PROBLEM=[problem] AND STATUS=[status]" tail of a query.
+void parseSubmissionFilter(istringstream& iss, string& problem,
+                           string& status) {
+    string rest;
+    getline(iss, rest);
+
+    size_t probPos = rest.find("PROBLEM=");
+    size_t statPos = rest.find("STATUS=");
+
+    problem = rest.substr(probPos + 8, statPos - probPos - 13);
+    status = rest.substr(statPos + 7);
+}
+
 int main() {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
 
-    ICPCSystem system;
+    ICPCSystem<IcpcRules> system;
     string line;
 
     while (getline(cin, line)) {
@@ -426,23 +2210,99 @@ int main() {
             system.freeze();
         } else if (command == "SCROLL") {
             system.scroll();
+        } else if (command == "EXPORT_SCROLL") {
+            string path;
+            iss >> path;
+            system.exportScroll(path);
+        } else if (command == "PUBLISH_BOARD") {
+            string name;
+            iss >> name;
+            system.publishBoard(name);
+        } else if (command == "ADD_SITE") {
+            string segment;
+            iss >> segment;
+            system.addSite(segment);
+        } else if (command == "QUERY_MERGED_BOARD") {
+            system.queryMergedBoard();
+        } else if (command == "PREVIEW_SCROLL") {
+            system.previewScroll();
         } else if (command == "QUERY_RANKING") {
             string name;
             iss >> name;
             system.queryRanking(name);
+        } else if (command == "QUERY_TRUE_RANKING") {
+            string name;
+            iss >> name;
+            system.queryTrueRanking(name);
+        } else if (command == "QUERY_HYPOTHETICAL") {
+            string dummy;
+            int solved, penalty;
+            iss >> dummy >> solved >> dummy >> penalty >> dummy;
+            vector<int> times(solved);
+            for (auto& t : times) {
+                iss >> t;
+            }
+            system.queryHypothetical(solved, penalty, times);
+        } else if (command == "QUERY_COUNT") {
+            string dummy;
+            int solved, low, high;
+            iss >> dummy >> solved;
+            if (iss >> dummy >> low >> dummy >> high) {
+                system.queryCountPenalty(solved, low, high);
+            } else {
+                system.queryCountSolved(solved);
+            }
+        } else if (command == "EXPORT_BOARD") {
+            string format, path;
+            iss >> format >> path;
+            system.exportBoard(format, path);
+        } else if (command == "EXPORT_SNAPSHOT") {
+            string path;
+            iss >> path;
+            system.exportSnapshot(path);
+        } else if (command == "SET_BOARD_OUTPUT") {
+            string mode;
+            iss >> mode;
+            system.setBoardOutput(mode);
+        } else if (command == "SET_MEDALS") {
+            int gold, silver, bronze;
+            iss >> gold >> silver >> bronze;
+            system.setMedals(gold, silver, bronze);
+        } else if (command == "QUERY_AWARDS") {
+            system.queryAwards();
+        } else if (command == "QUERY_RANKING_AT") {
+            string name, dummy;
+            int version;
+            iss >> name >> dummy >> version;
+            system.queryRankingAt(name, version);
+        } else if (command == "QUERY_BOARD_AT") {
+            string dummy;
+            int version;
+            iss >> dummy >> version;
+            system.queryBoardAt(version);
+        } else if (command == "QUERY_SUBMISSIONS") {
+            string teamName, dummy;
+            int from, to;
+            iss >> teamName >> dummy >> from >> dummy >> to;
+            system.queryTeamSubmissions(teamName, from, to);
+        } else if (command == "QUERY_PROBLEM_SUBMISSIONS") {
+            string problem, dummy;
+            int from, to;
+            iss >> problem >> dummy >> from >> dummy >> to;
+            system.queryProblemSubmissions(problem, from, to);
+        } else if (command == "QUERY_PROBLEM_STATS") {
+            system.queryProblemStats();
         } else if (command == "QUERY_SUBMISSION") {
-            string teamName, where, rest;
+            string teamName, where, problem, status;
             iss >> teamName >> where;
-            getline(iss, rest);
-
-            size_t probPos = rest.find("PROBLEM=");
-            size_t statPos = rest.find("STATUS=");
-
-            string problem = rest.substr(probPos + 8,
-                statPos - probPos - 13);
-            string status = rest.substr(statPos + 7);
-
+            parseSubmissionFilter(iss, problem, status);
             system.querySubmission(teamName, problem, status);
+        } else if (command == "QUERY_LAST_SUBMISSIONS") {
+            string teamName, where, problem, status;
+            int count;
+            iss >> teamName >> count >> where;
+            parseSubmissionFilter(iss, problem, status);
+            system.queryLastSubmissions(teamName, count, problem, status);
         } else if (command == "END") {
             system.end();
             break;
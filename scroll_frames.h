@@ -0,0 +1,37 @@
+#ifndef SCROLL_FRAMES_H
+#define SCROLL_FRAMES_H
+
+#include <cstdint>
+
+// Binary scroll export written by EXPORT_SCROLL: one ScrollFramesHeader
+// followed by frameCount ScrollFrame records, one per unfreeze in scroll
+// order. All fields are little-endian; team ids follow ADDTEAM order from
+// 0 and problems count from 0 for A. A reader can map the file and index
+// the records directly.
+
+const char kScrollFramesMagic[8] = {'I', 'C', 'P', 'C', 'S', 'C', 'R', 'L'};
+const uint32_t kScrollFramesVersion = 1;
+
+struct ScrollFramesHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t frameSize;  // sizeof(ScrollFrame)
+    uint32_t teamCount;
+    uint32_t problemCount;
+    uint32_t frameCount;
+    uint32_t reserved;
+};
+
+struct ScrollFrame {
+    int32_t team;
+    int32_t problem;
+    int32_t oldRank;
+    int32_t newRank;  // equal to oldRank when the ranking did not change
+    int32_t solved;   // after the unfreeze
+    int32_t penalty;
+};
+
+static_assert(sizeof(ScrollFramesHeader) == 32, "unexpected header layout");
+static_assert(sizeof(ScrollFrame) == 24, "unexpected frame layout");
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef SHARED_BOARD_H
+#define SHARED_BOARD_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+// Scoreboard published by PUBLISH_BOARD into a POSIX shared-memory
+// segment: one SharedBoardHeader, teamCount BoardRow records in ranking
+// order, then teamCount zero-padded names indexed by team id. Team ids
+// follow ADDTEAM order from 0 and cells are indexed by problem from 0 for
+// A; cells past problemCount are zero. Names never change once published.
+//
+// The writer republishes on every FLUSH and SCROLL under a seqlock, so a
+// reader maps the segment read-only and copies the board out with
+// readSharedBoard, never blocking the engine; a reader gives up after
+// kSharedBoardReadTimeout rather than wait on a writer that died
+// mid-publish. A new PUBLISH_BOARD over
+// the same segment rewrites the header and names under the seqlock too,
+// and never shrinks the segment.
+
+const char kSharedBoardMagic[8] = {'I', 'C', 'P', 'C', 'S', 'H', 'M', 'B'};
+const uint32_t kSharedBoardVersion = 2;
+const int kBoardProblems = 26;
+const int kBoardNameSize = 24;  // names are at most 20 characters
+const std::chrono::milliseconds kSharedBoardReadTimeout(100);
+
+struct BoardCell {
+    int32_t solveTime;  // 0 if not solved
+    int32_t wrongAttempts;
+    int32_t frozenSubmissions;
+};
+
+struct BoardRow {
+    int32_t team;
+    int32_t rank;
+    int32_t solved;
+    int32_t penalty;
+    BoardCell cells[kBoardProblems];
+};
+
+struct SharedBoardHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t rowSize;  // sizeof(BoardRow)
+    std::atomic<uint32_t> sequence;  // odd while a publish is in progress
+    uint32_t teamCount;
+    uint32_t problemCount;
+    uint32_t boardVersion;  // flush number of the published board
+};
+
+static_assert(sizeof(BoardRow) == 328, "unexpected row layout");
+static_assert(sizeof(SharedBoardHeader) == 32, "unexpected header layout");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "seqlock needs a lock-free counter");
+
+inline const BoardRow* sharedBoardRows(const SharedBoardHeader* shared) {
+    return reinterpret_cast<const BoardRow*>(shared + 1);
+}
+
+inline const char* sharedBoardName(const SharedBoardHeader* shared,
+                                   uint32_t team) {
+    return reinterpret_cast<const char*>(sharedBoardRows(shared) +
+                                         shared->teamCount) +
+           team * kBoardNameSize;
+}
+
+inline size_t sharedBoardSize(uint32_t teamCount) {
+    return sizeof(SharedBoardHeader) +
+           teamCount * (sizeof(BoardRow) + kBoardNameSize);
+}
+
+// Teams a reader's mapping of `mappedBytes` has room for.
+inline size_t sharedBoardCapacity(size_t mappedBytes) {
+    if (mappedBytes < sizeof(SharedBoardHeader)) {
+        return 0;
+    }
+    return (mappedBytes - sizeof(SharedBoardHeader)) /
+           (sizeof(BoardRow) + kBoardNameSize);
+}
+
+// Header fields that go with a board copied by readSharedBoard.
+struct SharedBoardInfo {
+    uint32_t sequence;  // the publish the copy belongs to
+    uint32_t boardVersion;  // flush number of the board
+    uint32_t teamCount;
+    uint32_t problemCount;
+};
+
+enum SharedBoardRead {
+    kSharedBoardCopied,
+    kSharedBoardOutgrown,  // more teams than the mapping holds; map again
+    kSharedBoardBusy,  // no consistent copy within kSharedBoardReadTimeout
+};
+
+// Copies a consistent board out of a segment mapped over `mappedBytes`,
+// retrying while the writer is mid-publish: rows into `rows` and names
+// into `names`, each with room for sharedBoardCapacity(mappedBytes)
+// teams.
+inline SharedBoardRead readSharedBoard(const SharedBoardHeader* shared,
+                                       size_t mappedBytes, BoardRow* rows,
+                                       char* names, SharedBoardInfo& info) {
+    auto deadline = std::chrono::steady_clock::now() + kSharedBoardReadTimeout;
+    for (;;) {
+        uint32_t before = shared->sequence.load(std::memory_order_acquire);
+        if (!(before & 1)) {
+            info.sequence = before;
+            info.boardVersion = shared->boardVersion;
+            info.teamCount = shared->teamCount;
+            info.problemCount = shared->problemCount;
+            bool fits = info.teamCount <= sharedBoardCapacity(mappedBytes);
+            if (fits) {
+                const BoardRow* source = sharedBoardRows(shared);
+                std::memcpy(rows, source, info.teamCount * sizeof(BoardRow));
+                std::memcpy(names, source + info.teamCount,
+                            info.teamCount * kBoardNameSize);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (shared->sequence.load(std::memory_order_relaxed) == before) {
+                return fits ? kSharedBoardCopied : kSharedBoardOutgrown;
+            }
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return kSharedBoardBusy;
+        }
+        std::this_thread::yield();
+    }
+}
+
+#endif